@@ -0,0 +1,562 @@
+/* 046267 Computer Architecture - HW #3 */
+/* Differential comparison of two dataflow analyses (baseline vs. modified) */
+
+#include "dflow_calc.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <vector>
+#include <algorithm>
+#include <queue>
+#include <thread>
+
+/// Default number of instructions reported in the top-N section
+#define DEFAULT_TOP_N 5
+
+/**
+ * @brief everything needed to analyze (and query) a single trace.
+ */
+struct DiffSide {
+    const char* opFname;
+    const char* progName;
+    const char* title; // "baseline" or "modified", for the report
+    unsigned int opsLatency[MAX_OPS];
+    std::vector<InstInfo> prog;
+    int progLen; // as returned by read_program(), <=0 if the trace could not be read
+    ProgCtx ctx;
+    int progDepth;
+    std::vector<int> depth; // getInstDepth() of every instruction
+    std::vector<unsigned int> path; // critical path, from Exit back to Entry
+    std::vector<bool> onPath; // flag per instruction - true if on the critical path
+};
+
+/**
+ * @brief single aligned instruction pair and its depth change.
+ */
+struct DepthDelta {
+    unsigned int baseInst;
+    unsigned int modInst;
+    int delta;
+};
+
+/**
+ * @brief orders deltas so the smallest |delta| is on top of a priority_queue -
+ * this makes the queue a bounded min-heap of the largest moves.
+ */
+struct DeltaGreater {
+    bool operator()(const DepthDelta& a, const DepthDelta& b) const {
+        int abs_a = abs(a.delta);
+        int abs_b = abs(b.delta);
+        if (abs_a != abs_b) {
+            return abs_a > abs_b;
+        }
+        return a.baseInst < b.baseInst; // on ties keep the earlier instruction
+    }
+};
+
+/**
+ * @fn read_ops_latency
+ * @brief reads opcodes latency file (one decimal number per line).
+ * same rules as readOpsLatency() of dflow_main.c, so both tools accept the same files.
+ * @param[in] opFname the latency file name.
+ * @param[out] opsLatency array of MAX_OPS entries, unused entries are set to 0.
+ * @return number of opcodes read, <0 on error.
+ */
+static int read_ops_latency(const char* opFname, unsigned int opsLatency[]) {
+    int numOps = 0;
+    char curLine[81];
+    char *endOfVal;
+
+    for (int i = 0; i < MAX_OPS; i++) {
+        opsLatency[i] = 0;
+    }
+
+    FILE *opcodeFile = fopen(opFname, "r");
+    if (opcodeFile == NULL) {
+        printf("ERROR: Failed openning %s\n", opFname);
+        return -1;
+    }
+
+    while (fgets(curLine, sizeof(curLine), opcodeFile) != NULL) {
+        if (numOps >= MAX_OPS) {
+            printf("ERROR: Opcodes latency file has more opcodes than maximum supported\n");
+            fclose(opcodeFile);
+            return -3;
+        }
+        opsLatency[numOps++] = strtol(curLine, &endOfVal, 10);
+        while (isspace(*endOfVal)) ++endOfVal; // Strip trailing spaces
+        if (endOfVal[0] != 0) {
+            printf("ERROR: Failed parsing opcode latency at line %d of %s\n", numOps, opFname);
+            fclose(opcodeFile);
+            return -2;
+        }
+    }
+
+    fclose(opcodeFile);
+    return numOps;
+}
+
+/**
+ * @fn read_program
+ * @brief reads a program trace of "opcode dst src1 src2" lines.
+ * same rules as readProgram() of dflow_main.c, except that negative opcodes or
+ * source registers are rejected instead of wrapping around.
+ * runs concurrently on both analysis threads, so it must stay reentrant
+ * (strtok_r with a local save pointer, no static state).
+ * @param[in] progName the trace file name.
+ * @param[out] prog the instructions read from the file.
+ * @return number of instructions read, <0 on error.
+ */
+static int read_program(const char* progName, std::vector<InstInfo>& prog) {
+    char curLine[81];
+    char *curField, *endOfVal;
+    long int fieldVal[4];
+    char *tokenizerEntry; // Entry "tag" for strtok_r()
+    char *tokenizerSave; // strtok_r() position - per call, unlike strtok()'s hidden state
+
+    FILE *progFile = fopen(progName, "r");
+    if (progFile == NULL) {
+        printf("ERROR: Failed openning the program file: %s\n", progName);
+        return -1;
+    }
+
+    while (fgets(curLine, sizeof(curLine), progFile) != NULL) {
+        tokenizerEntry = curLine;
+        while (isspace(*tokenizerEntry)) ++tokenizerEntry; // Strip leading whitespace
+        if ((tokenizerEntry[0] == 0) || (tokenizerEntry[0] == '#')) {
+            continue; // Ignore empty lines and comments (lines that start with '#')
+        }
+
+        for (int i = 0; i < 4; i++) {
+            curField = strtok_r(tokenizerEntry, " \t\n\r", &tokenizerSave);
+            if (curField == NULL) {
+                printf("ERROR: Error parsing instruction #%zu of %s\n", prog.size(), progName);
+                fclose(progFile);
+                return -2;
+            }
+            fieldVal[i] = strtol(curField, &endOfVal, 10);
+            if (endOfVal[0] != 0) {
+                printf("ERROR: Failed parsing field %d of line #%zu of %s: %s\n", i, prog.size(), progName, curLine);
+                fclose(progFile);
+                return -2;
+            }
+            tokenizerEntry = NULL; // for next tokens should provide strtok_r NULL
+        }
+        if (fieldVal[0] < 0 || fieldVal[0] >= MAX_OPS) {
+            printf("ERROR: Invalid opcode %ld in instruction #%zu of %s\n", fieldVal[0], prog.size(), progName);
+            fclose(progFile);
+            return -2;
+        }
+        if (fieldVal[2] < 0 || fieldVal[3] < 0) {
+            printf("ERROR: Negative source register in instruction #%zu of %s\n", prog.size(), progName);
+            fclose(progFile);
+            return -2;
+        }
+
+        InstInfo inst;
+        inst.opcode = fieldVal[0];
+        inst.dstIdx = fieldVal[1];
+        inst.src1Idx = fieldVal[2];
+        inst.src2Idx = fieldVal[3];
+        prog.push_back(inst);
+    }
+
+    fclose(progFile);
+    return static_cast<int>(prog.size());
+}
+
+/**
+ * @brief yields the aligned instruction pairs one at a time - by index, or from
+ * a "<baseline inst#> <modified inst#>" mapping file that is read line by line
+ * and never held in memory.
+ */
+class PairReader {
+    FILE* mapFile;
+    const char* mapFname;
+    unsigned int baseLen;
+    unsigned int modLen;
+    unsigned int nextIdx; // next index to yield when aligning by index
+    unsigned int lineNum; // current line of the mapping file
+
+    public:
+        /**
+         * @fn PairReader
+         * @brief define a reader over the pairs of two traces.
+         * @param[in] mapFname the mapping file name, or NULL to align by index.
+         * @param[in] baseLen number of instructions in the baseline trace.
+         * @param[in] modLen number of instructions in the modified trace.
+         */
+        PairReader(const char* mapFname, unsigned int baseLen, unsigned int modLen) {
+            this->mapFile = NULL;
+            this->mapFname = mapFname;
+            this->baseLen = baseLen;
+            this->modLen = modLen;
+            this->nextIdx = 0;
+            this->lineNum = 0;
+        }
+
+        ~PairReader() {
+            if (this->mapFile) {
+                fclose(this->mapFile);
+            }
+        }
+
+        /**
+         * @fn open
+         * @brief opens the mapping file (if any).
+         * @return 0 on success, <0 on error.
+         */
+        int open() {
+            if (!this->mapFname) {
+                return 0;
+            }
+
+            this->mapFile = fopen(this->mapFname, "r");
+            if (this->mapFile == NULL) {
+                printf("ERROR: Failed openning the mapping file: %s\n", this->mapFname);
+                return -1;
+            }
+            return 0;
+        }
+
+        /**
+         * @fn next
+         * @brief gets the next aligned pair.
+         * @param[out] pair the pair, with delta 0.
+         * @return 1 if a pair was read, 0 at the end, <0 on error.
+         */
+        int next(DepthDelta& pair) {
+            pair.delta = 0;
+
+            if (!this->mapFile) {
+                if (this->nextIdx >= this->baseLen || this->nextIdx >= this->modLen) {
+                    return 0;
+                }
+                pair.baseInst = pair.modInst = this->nextIdx++;
+                return 1;
+            }
+
+            char curLine[81];
+            char *curField, *endOfVal;
+            long int fieldVal[2];
+            char *tokenizerEntry; // Entry "tag" for strtok_r()
+            char *tokenizerSave; // strtok_r() position
+
+            while (fgets(curLine, sizeof(curLine), this->mapFile) != NULL) {
+                this->lineNum++;
+                tokenizerEntry = curLine;
+                while (isspace(*tokenizerEntry)) ++tokenizerEntry; // Strip leading whitespace
+                if ((tokenizerEntry[0] == 0) || (tokenizerEntry[0] == '#')) {
+                    continue; // Ignore empty lines and comments (lines that start with '#')
+                }
+
+                for (int i = 0; i < 2; i++) {
+                    curField = strtok_r(tokenizerEntry, " \t\n\r", &tokenizerSave);
+                    if (curField == NULL) {
+                        printf("ERROR: Failed parsing line #%u of %s\n", this->lineNum, this->mapFname);
+                        return -2;
+                    }
+                    fieldVal[i] = strtol(curField, &endOfVal, 10);
+                    if (endOfVal[0] != 0) {
+                        printf("ERROR: Failed parsing field %d of line #%u of %s\n", i, this->lineNum, this->mapFname);
+                        return -2;
+                    }
+                    tokenizerEntry = NULL; // for next tokens should provide strtok_r NULL
+                }
+                if (strtok_r(NULL, " \t\n\r", &tokenizerSave) != NULL) {
+                    printf("ERROR: Extra fields at line #%u of %s\n", this->lineNum, this->mapFname);
+                    return -2;
+                }
+                if (fieldVal[0] < 0 || fieldVal[0] >= this->baseLen ||
+                    fieldVal[1] < 0 || fieldVal[1] >= this->modLen) {
+                    printf("ERROR: Instruction index out of range at line #%u of %s\n", this->lineNum, this->mapFname);
+                    return -2;
+                }
+
+                pair.baseInst = fieldVal[0];
+                pair.modInst = fieldVal[1];
+                return 1;
+            }
+
+            return 0;
+        }
+};
+
+/**
+ * @fn finish_time
+ * @brief the cycle in which an instruction's result is ready.
+ * @param[in] side the analyzed side, with depths filled in.
+ * @param[in] inst the instruction index.
+ * @return depth of the instruction + its latency.
+ */
+static int finish_time(const DiffSide& side, unsigned int inst) {
+    return side.depth[inst] + side.opsLatency[side.prog[inst].opcode];
+}
+
+/**
+ * @fn critical_path
+ * @brief finds the longest Entry->Exit path. walks back from the instruction
+ * that ends last, each time to the source that determined the depth.
+ * @param[in,out] side the analyzed side - fills its path and onPath.
+ */
+static void critical_path(DiffSide* side) {
+    int curr = -1;
+
+    side->onPath.assign(side->prog.size(), false);
+
+    for (int i = static_cast<int>(side->prog.size()) - 1; i >= 0; i--) {
+        if (finish_time(*side, i) == side->progDepth) {
+            curr = i;
+            break;
+        }
+    }
+
+    while (curr >= 0) {
+        side->path.push_back(curr);
+        side->onPath[curr] = true;
+
+        int src1, src2;
+        getInstDeps(side->ctx, curr, &src1, &src2);
+
+        if (src1 >= 0 && finish_time(*side, src1) == side->depth[curr]) {
+            curr = src1;
+        } else if (src2 >= 0 && finish_time(*side, src2) == side->depth[curr]) {
+            curr = src2;
+        } else {
+            curr = -1; // depends only on Entry
+        }
+    }
+}
+
+/**
+ * @fn print_critical_path
+ * @brief prints the critical path of a side in program order.
+ * @param[in] side the analyzed side.
+ */
+static void print_critical_path(const DiffSide& side) {
+    printf("%c%s critical path:", toupper(side.title[0]), side.title + 1);
+    for (int i = static_cast<int>(side.path.size()) - 1; i >= 0; i--) {
+        printf(" %u", side.path[i]);
+    }
+    printf("\n");
+}
+
+/**
+ * @fn analyze_side
+ * @brief reads the trace of one side, analyzes it, and runs all the queries
+ * the report needs (every getInstDepth() and the critical path). runs on its
+ * own thread, so only the side's own context is touched.
+ * the opcodes latency must already be filled in.
+ * @param[in,out] side the side to analyze. ctx stays PROG_CTX_NULL on failure.
+ */
+static void analyze_side(DiffSide* side) {
+    side->ctx = PROG_CTX_NULL;
+
+    side->progLen = read_program(side->progName, side->prog);
+    if (side->progLen <= 0) {
+        return;
+    }
+
+    side->ctx = analyzeProg(side->opsLatency, side->prog.data(), side->progLen);
+    if (side->ctx == PROG_CTX_NULL) {
+        return;
+    }
+
+    // getInstDepth() searches and sorts the whole graph - query each instruction once, here
+    side->progDepth = getProgDepth(side->ctx);
+    side->depth.resize(side->progLen);
+    for (int i = 0; i < side->progLen; i++) {
+        side->depth[i] = getInstDepth(side->ctx, i);
+    }
+    critical_path(side);
+}
+
+/**
+ * @fn report_side_failure
+ * @brief prints why a side has no context - reading its trace or analyzing it.
+ * @param[in] side the side to check.
+ * @return 0 if the side was analyzed, 1 if its trace could not be read, 2 if analyzeProg() failed.
+ */
+static int report_side_failure(const DiffSide& side) {
+    if (side.progLen <= 0) {
+        printf("Error reading the %s program file %s!\n", side.title, side.progName);
+        return 1;
+    }
+    if (side.ctx == PROG_CTX_NULL) {
+        printf("Error on invocation to analyzeProg() for the %s program %s\n", side.title, side.progName);
+        return 2;
+    }
+    return 0;
+}
+
+void usage(void) {
+    printf("Usage: dflow_diff [-n <N>] [-m <mapping file>] [-O <modified opcodes file>]\n");
+    printf("                  <opcodes info. filename> <baseline program> <modified program>\n");
+    printf("\t-n: Number of instructions to report whose depth moved the most (default %d)\n", DEFAULT_TOP_N);
+    printf("\t-m: Align by \"<baseline inst#> <modified inst#>\" lines instead of by instruction index\n");
+    printf("\t-O: Opcodes latency of the modified program (default: same as the baseline)\n");
+    printf("Example: dflow_diff -n 3 opcode.dat example1.in example1-opt.in\n");
+    exit(1);
+}
+
+int main(int argc, const char *argv[]) {
+    unsigned int topN = DEFAULT_TOP_N;
+    const char *mapFname = NULL;
+    const char *modOpFname = NULL;
+    char *endPtr;
+    int argIdx = 1;
+
+    // Parse options
+    while (argIdx < argc && argv[argIdx][0] == '-') {
+        const char *opt = argv[argIdx];
+        if (strlen(opt) != 2 || argIdx + 1 >= argc) {
+            usage();
+        }
+        const char *val = argv[argIdx + 1];
+        switch (opt[1]) {
+        case 'n': {
+            errno = 0;
+            unsigned long n = strtoul(val, &endPtr, 10);
+            // strtoul silently accepts "" and negates "-1" - reject both, and values above UINT_MAX
+            if (val[0] == 0 || val[0] == '-' || isspace(val[0]) || *endPtr != 0 || errno == ERANGE || n > UINT_MAX) {
+                printf("Error: Invalid number of instructions: %s\n", val);
+                exit(3);
+            }
+            topN = n;
+            break;
+        }
+        case 'm':
+            mapFname = val;
+            break;
+        case 'O':
+            modOpFname = val;
+            break;
+        default:
+            usage();
+        }
+        argIdx += 2;
+    }
+    if (argc - argIdx != 3) {
+        usage();
+    }
+
+    DiffSide base, mod;
+    base.opFname = argv[argIdx];
+    base.progName = argv[argIdx + 1];
+    base.title = "baseline";
+    mod.opFname = modOpFname ? modOpFname : base.opFname;
+    mod.progName = argv[argIdx + 2];
+    mod.title = "modified";
+
+    // Opcode files are small - read them up front, and a shared one only once
+    if (read_ops_latency(base.opFname, base.opsLatency) < 0) {
+        exit(1);
+    }
+    if (modOpFname) {
+        if (read_ops_latency(mod.opFname, mod.opsLatency) < 0) {
+            exit(1);
+        }
+    } else {
+        memcpy(mod.opsLatency, base.opsLatency, sizeof(mod.opsLatency));
+    }
+
+    // Analyze and query both sides concurrently - the contexts share no state
+    std::thread baseThread(analyze_side, &base);
+    std::thread modThread(analyze_side, &mod);
+    baseThread.join();
+    modThread.join();
+
+    int baseRc = report_side_failure(base);
+    int modRc = report_side_failure(mod);
+    if (baseRc != 0 || modRc != 0) {
+        if (base.ctx != PROG_CTX_NULL) freeProgCtx(base.ctx);
+        if (mod.ctx != PROG_CTX_NULL) freeProgCtx(mod.ctx);
+        exit(baseRc > modRc ? baseRc : modRc);
+    }
+
+    unsigned int baseLen = base.prog.size();
+    unsigned int modLen = mod.prog.size();
+
+    PairReader pairs(mapFname, baseLen, modLen);
+    if (pairs.open() < 0) {
+        freeProgCtx(base.ctx);
+        freeProgCtx(mod.ctx);
+        exit(1);
+    }
+
+    printf("Baseline %s: %u instructions, getProgDepth()==%d\n", base.progName, baseLen, base.progDepth);
+    printf("Modified %s: %u instructions, getProgDepth()==%d\n", mod.progName, modLen, mod.progDepth);
+    printf("Depth delta: %+d\n", mod.progDepth - base.progDepth);
+    print_critical_path(base);
+    print_critical_path(mod);
+
+    // Stream the aligned pairs: depth change, critical path change and top-N update per pair
+    std::priority_queue<DepthDelta, std::vector<DepthDelta>, DeltaGreater> topHeap;
+    DepthDelta pair;
+    unsigned int numPairs = 0;
+    int numDepthChanges = 0, numPathChanges = 0;
+    int rc;
+
+    printf("Instruction changes (aligned by %s):\n", mapFname ? mapFname : "index");
+    while ((rc = pairs.next(pair)) > 0) {
+        numPairs++;
+        int baseInstDepth = base.depth[pair.baseInst];
+        int modInstDepth = mod.depth[pair.modInst];
+        bool inBase = base.onPath[pair.baseInst];
+        bool inMod = mod.onPath[pair.modInst];
+        pair.delta = modInstDepth - baseInstDepth;
+        if (pair.delta == 0 && inBase == inMod) {
+            continue;
+        }
+
+        printf("  %u->%u: %d->%d (%+d)", pair.baseInst, pair.modInst, baseInstDepth, modInstDepth, pair.delta);
+        if (inBase != inMod) {
+            printf(", %s critical path", inBase ? "left" : "joined");
+            numPathChanges++;
+        }
+        printf("\n");
+
+        if (pair.delta == 0) {
+            continue;
+        }
+        numDepthChanges++;
+        if (topN == 0) {
+            continue;
+        }
+        if (topHeap.size() < topN) {
+            topHeap.push(pair);
+        } else if (DeltaGreater()(pair, topHeap.top())) {
+            topHeap.pop();
+            topHeap.push(pair);
+        }
+    }
+    if (rc < 0) {
+        freeProgCtx(base.ctx);
+        freeProgCtx(mod.ctx);
+        exit(1);
+    }
+    printf("Aligned %u instructions: %d depth changes, %d critical path changes\n",
+           numPairs, numDepthChanges, numPathChanges);
+
+    // The heap pops the smallest move first - report from the largest down
+    std::vector<DepthDelta> top;
+    while (!topHeap.empty()) {
+        top.push_back(topHeap.top());
+        topHeap.pop();
+    }
+    std::reverse(top.begin(), top.end());
+    printf("Top %u depth moves:\n", topN);
+    for (size_t i = 0; i < top.size(); i++) {
+        printf("  %u->%u: %+d\n", top[i].baseInst, top[i].modInst, top[i].delta);
+    }
+    if (top.empty()) {
+        printf("  (none)\n");
+    }
+
+    freeProgCtx(base.ctx);
+    freeProgCtx(mod.ctx);
+    return 0;
+}